@@ -0,0 +1,102 @@
+/*
+ * Microbenchmark of simd_memcmp() against the memcmp() of the C library, on
+ * keys shaped like the ones queues hold in practice. As element_cmp() does,
+ * it compares what follows the first 8 bytes of two keys of equal length,
+ * since the prefix is settled by the cached integer before any string is
+ * read. Every result is checked against memcmp() before it is timed.
+ *
+ * Build and run with "make bench".
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "simd_cmp.h"
+
+#define KEYS 512
+#define KEY_SIZE 96
+#define PAIRS (1 << 16)
+#define ROUNDS 8
+#define REPEATS 30
+#define PREFIX sizeof(uint64_t)
+
+static const char *formats[] = {
+    "sess:%07d",
+    "session:%010d",
+    "user/profile/%012d",
+    "https://example.com/items/%08d",
+    "/var/log/service/archive/2024/%010d.log.gz",
+};
+
+static char keys[KEYS][KEY_SIZE];
+static int pairs[PAIRS];
+
+static double now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static int sign(int x)
+{
+    return (x > 0) - (x < 0);
+}
+
+/* Seconds taken by @ROUNDS passes of @cmp over the pairs, inlined */
+#define RUN(cmp, n, sink)                                                   \
+    ({                                                                      \
+        long acc = 0;                                                       \
+        double start = now();                                               \
+        for (int r = 0; r < ROUNDS; r++) {                                  \
+            for (int i = 0; i + 1 < PAIRS; i++) {                           \
+                acc += cmp(keys[pairs[i]] + PREFIX,                         \
+                           keys[pairs[i + 1]] + PREFIX, n) > 0;             \
+            }                                                               \
+        }                                                                   \
+        sink += acc;                                                        \
+        now() - start;                                                      \
+    })
+
+int main(void)
+{
+    long sink = 0;
+
+    printf("%4s %5s %12s %12s\n", "key", "rest", "memcmp", "simd_memcmp");
+    for (size_t f = 0; f < sizeof(formats) / sizeof(formats[0]); f++) {
+        int len = 0;
+        srand(f);
+        for (int i = 0; i < KEYS; i++)
+            len = snprintf(keys[i], KEY_SIZE, formats[f], rand() % 10000);
+        for (int i = 0; i < PAIRS; i++)
+            pairs[i] = rand() % KEYS;
+
+        size_t n = len - PREFIX;
+        for (int i = 0; i + 1 < PAIRS; i++) {
+            const char *a = keys[pairs[i]] + PREFIX;
+            const char *b = keys[pairs[i + 1]] + PREFIX;
+            if (sign(simd_memcmp(a, b, n)) != sign(memcmp(a, b, n))) {
+                fprintf(stderr, "mismatch on \"%s\" and \"%s\"\n",
+                        keys[pairs[i]], keys[pairs[i + 1]]);
+                return EXIT_FAILURE;
+            }
+        }
+
+        double best_libc = 1e9, best_simd = 1e9;
+        for (int r = 0; r < REPEATS; r++) {
+            double t = RUN(memcmp, n, sink);
+            if (t < best_libc)
+                best_libc = t;
+            t = RUN(simd_memcmp, n, sink);
+            if (t < best_simd)
+                best_simd = t;
+        }
+        printf("%4d %5zu %9.2f ns %9.2f ns\n", len, n,
+               best_libc * 1e9 / ROUNDS / PAIRS,
+               best_simd * 1e9 / ROUNDS / PAIRS);
+    }
+    return sink == -1;
+}
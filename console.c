@@ -1,9 +1,11 @@
 /* Implementation of simple command-line interface */
 
 #include <ctype.h>
+#include <errno.h>
 #include <fcntl.h>
 #include <limits.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -288,13 +290,25 @@ bool get_int(char *vname, int *loc)
 {
     char *end = NULL;
     long int v = strtol(vname, &end, 0);
-    if (v == LONG_MIN || *end != '\0')
+    if (v < INT_MIN || v > INT_MAX || *end != '\0')
         return false;
 
     *loc = (int) v;
     return true;
 }
 
+bool get_size(char *vname, size_t *loc)
+{
+    char *end = NULL;
+    errno = 0;
+    unsigned long long v = strtoull(vname, &end, 0);
+    if (errno || vname[0] == '-' || v > SIZE_MAX || *end != '\0')
+        return false;
+
+    *loc = (size_t) v;
+    return true;
+}
+
 static bool do_option(int argc, char *argv[])
 {
     if (argc == 1) {
@@ -2,6 +2,7 @@
 #define LAB0_CONSOLE_H
 
 #include <stdbool.h>
+#include <stddef.h>
 #include <sys/select.h>
 
 #include "linenoise.h"
@@ -53,6 +54,9 @@ void add_param(char *name, int *valp, char *summary, setter_func_t setter);
 /* Extract integer from text and store at loc */
 bool get_int(char *vname, int *loc);
 
+/* Extract non-negative count from text and store at loc */
+bool get_size(char *vname, size_t *loc);
+
 /* Add function to be executed as part of program exit */
 void add_quit_helper(cmd_func_t qf);
 
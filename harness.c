@@ -1,5 +1,6 @@
 /* Test support code */
 
+#include <pthread.h>
 #include <setjmp.h>
 #include <signal.h>
 #include <stdio.h>
@@ -46,20 +47,85 @@ static size_t allocated_count = 0;
 /* Percent probability of malloc failure */
 int fail_probability = 0;
 
-static bool cautious_mode = true;
+/* Cautious mode is per thread, so that the reclaimer is not affected by it.
+ * The rule against allocating holds for every thread, those sorting for a
+ * command included, except the reclaimer: it frees on behalf of commands run
+ * earlier, which may overlap one disallowing it.
+ */
+static _Thread_local bool cautious_mode = true;
+static _Thread_local bool reclaimer_thread = false;
 static bool noallocate_mode = false;
 static bool error_occurred = false;
 static char *error_message = "";
 
-static int time_limit = 1;
+/* Time limit of risky operations in seconds, 0 for none */
+int time_limit = 1;
 
 /* Data for managing exceptions */
 static jmp_buf env;
 static volatile sig_atomic_t jmp_ready = false;
 static bool time_limited = false;
 
+/* Calls deferred with test_defer(), run in order by the reclaimer thread */
+typedef struct __deferred_call {
+    struct __deferred_call *next;
+    void (*fn)(void *);
+    void *arg;
+} deferred_call_t;
+
+static struct {
+    pthread_mutex_t lock;
+    pthread_cond_t work, idle;
+    deferred_call_t *head, **tail;
+    size_t pending;
+    bool running;
+} reclaimer = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .work = PTHREAD_COND_INITIALIZER,
+    .idle = PTHREAD_COND_INITIALIZER,
+    .tail = &reclaimer.head,
+};
+
+/* The main thread holds back alarms while it holds the lock of the reclaimer,
+ * since a timeout jumping out would leave it locked for good.
+ */
+static void lock_reclaimer(sigset_t *old)
+{
+    sigset_t alarm;
+    sigemptyset(&alarm);
+    sigaddset(&alarm, SIGALRM);
+    pthread_sigmask(SIG_BLOCK, &alarm, old);
+    pthread_mutex_lock(&reclaimer.lock);
+}
+
+static void unlock_reclaimer(const sigset_t *old)
+{
+    pthread_mutex_unlock(&reclaimer.lock);
+    pthread_sigmask(SIG_SETMASK, old, NULL);
+}
+
+/* Guards the list of allocated blocks once the reclaimer is running */
+static pthread_mutex_t heap_lock = PTHREAD_MUTEX_INITIALIZER;
+static _Thread_local bool heap_locked = false;
+
 /* Internal functions */
 
+static void lock_heap()
+{
+    if (reclaimer.running) {
+        pthread_mutex_lock(&heap_lock);
+        heap_locked = true;
+    }
+}
+
+static void unlock_heap()
+{
+    if (heap_locked) {
+        heap_locked = false;
+        pthread_mutex_unlock(&heap_lock);
+    }
+}
+
 /* Should this allocation fail? */
 static bool fail_allocation()
 {
@@ -119,7 +185,7 @@ static size_t *find_footer(block_element_t *b)
 
 void *test_malloc(size_t size)
 {
-    if (noallocate_mode) {
+    if (!reclaimer_thread && noallocate_mode) {
         report_event(MSG_FATAL, "Calls to malloc disallowed");
         return NULL;
     }
@@ -143,6 +209,7 @@ void *test_malloc(size_t size)
     *find_footer(new_block) = MAGICFOOTER;
     void *p = (void *) &new_block->payload;
     memset(p, FILLCHAR, size);
+    lock_heap();
     // cppcheck-suppress nullPointerRedundantCheck
     new_block->next = allocated;
     // cppcheck-suppress nullPointerRedundantCheck
@@ -152,6 +219,7 @@ void *test_malloc(size_t size)
         allocated->prev = new_block;
     allocated = new_block;
     allocated_count++;
+    unlock_heap();
 
     return p;
 }
@@ -170,7 +238,7 @@ void *test_calloc(size_t nelem, size_t elsize)
 
 void test_free(void *p)
 {
-    if (noallocate_mode) {
+    if (!reclaimer_thread && noallocate_mode) {
         report_event(MSG_FATAL, "Calls to free disallowed");
         return;
     }
@@ -178,6 +246,7 @@ void test_free(void *p)
     if (!p)
         return;
 
+    lock_heap();
     block_element_t *b = find_header(p);
     size_t footer = *find_footer(b);
     if (footer != MAGICFOOTER) {
@@ -200,9 +269,10 @@ void test_free(void *p)
         allocated = bn;
     if (bn)
         bn->prev = bp;
+    allocated_count--;
+    unlock_heap();
 
     free(b);
-    allocated_count--;
 }
 
 // cppcheck-suppress unusedFunction
@@ -216,9 +286,96 @@ char *test_strdup(const char *s)
     return memcpy(new, s, len);
 }
 
+static void *reclaimer_main(void *unused)
+{
+    /* Blocks handed over have been checked when they were allocated, and
+     * searching the allocated list for each of them would hold the lock for
+     * too long.
+     */
+    cautious_mode = false;
+    reclaimer_thread = true;
+
+    pthread_mutex_lock(&reclaimer.lock);
+    while (true) {
+        while (!reclaimer.head)
+            pthread_cond_wait(&reclaimer.work, &reclaimer.lock);
+
+        deferred_call_t *call = reclaimer.head;
+        reclaimer.head = call->next;
+        if (!reclaimer.head)
+            reclaimer.tail = &reclaimer.head;
+        pthread_mutex_unlock(&reclaimer.lock);
+
+        call->fn(call->arg);
+        free(call);
+
+        pthread_mutex_lock(&reclaimer.lock);
+        if (--reclaimer.pending == 0)
+            pthread_cond_broadcast(&reclaimer.idle);
+    }
+
+    return NULL;
+}
+
+static bool reclaimer_start()
+{
+    /* The reclaimer inherits a mask blocking every signal, so that alarms
+     * and interrupts are always delivered to the main thread.
+     */
+    sigset_t all, old;
+    sigfillset(&all);
+    pthread_sigmask(SIG_SETMASK, &all, &old);
+
+    pthread_t thread;
+    reclaimer.running = !pthread_create(&thread, NULL, reclaimer_main, NULL);
+    if (reclaimer.running)
+        pthread_detach(thread);
+
+    pthread_sigmask(SIG_SETMASK, &old, NULL);
+    return reclaimer.running;
+}
+
+bool test_defer(void (*fn)(void *), void *arg)
+{
+    if (!reclaimer.running && !reclaimer_start())
+        return false;
+
+    deferred_call_t *call = malloc(sizeof(deferred_call_t));
+    if (!call)
+        return false;
+
+    call->next = NULL;
+    call->fn = fn;
+    call->arg = arg;
+
+    sigset_t old;
+    lock_reclaimer(&old);
+    *reclaimer.tail = call;
+    reclaimer.tail = &call->next;
+    reclaimer.pending++;
+    pthread_cond_signal(&reclaimer.work);
+    unlock_reclaimer(&old);
+    return true;
+}
+
+/* Wait until all deferred calls have completed */
+static void test_defer_flush()
+{
+    sigset_t old;
+    lock_reclaimer(&old);
+    while (reclaimer.pending)
+        pthread_cond_wait(&reclaimer.idle, &reclaimer.lock);
+    unlock_reclaimer(&old);
+}
+
 size_t allocation_check()
 {
-    return allocated_count;
+    test_defer_flush();
+
+    lock_heap();
+    size_t count = allocated_count;
+    unlock_heap();
+    return count;
 }
 
 /* Implementation of functions for testing */
@@ -253,7 +410,8 @@ bool error_check()
 bool exception_setup(bool limit_time)
 {
     if (sigsetjmp(env, 1)) {
-        /* Got here from longjmp */
+        /* Got here from longjmp, possibly out of test_malloc or test_free */
+        unlock_heap();
         jmp_ready = false;
         if (time_limited) {
             alarm(0);
@@ -16,14 +16,24 @@ void test_free(void *p);
 char *test_strdup(const char *s);
 /* FIXME: provide test_realloc as well */
 
+/* Have fn(arg) called later by a background thread, in the order of the
+ * calls to test_defer(). Blocks may be freed there even while malloc and free
+ * are disallowed for the tested program. Return false if the call could not
+ * be deferred, in which case the caller should do the work itself.
+ */
+bool test_defer(void (*fn)(void *), void *arg);
+
 #ifdef INTERNAL
 
-/* Report number of allocated blocks */
+/* Report number of allocated blocks, once all deferred calls have completed */
 size_t allocation_check();
 
 /* Probability of malloc failing, expressed as percent */
 extern int fail_probability;
 
+/* Time limit of operations guarded by exception_setup, in seconds */
+extern int time_limit;
+
 /*
  * Set/unset cautious mode.
  * In this mode, makes extra sure any block to be freed is currently allocated.
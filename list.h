@@ -334,6 +334,190 @@ static inline void list_move_tail(struct list_head *node,
     list_add_tail(node, head);
 }
 
+/**
+ * typedef list_cmp_func_t - Comparison callback of list_sort
+ * @priv: private data passed through list_sort unmodified
+ * @a: pointer to the first list node
+ * @b: pointer to the second list node
+ *
+ * Return: a value greater than zero if @a should be sorted after @b, zero or
+ * less otherwise. Nodes comparing equal keep their relative order.
+ */
+typedef int (*list_cmp_func_t)(void *priv,
+                               const struct list_head *a,
+                               const struct list_head *b);
+
+/* The sort is always inlined, so that the comparison of a caller passing a
+ * known function is called directly rather than through a pointer.
+ */
+#if defined(__GNUC__) || defined(__clang__)
+#define __LIST_SORT_INLINE static inline __attribute__((always_inline))
+#else
+#define __LIST_SORT_INLINE static inline
+#endif
+
+/**
+ * __list_merge() - Merge two sorted null-terminated lists
+ * @priv: private data for @cmp
+ * @cmp: comparison callback
+ * @a: first list, whose nodes win ties
+ * @b: second list
+ *
+ * Only the next pointers are maintained.
+ *
+ * Return: the first node of the merged list
+ */
+__LIST_SORT_INLINE struct list_head *__list_merge(void *priv,
+                                                  list_cmp_func_t cmp,
+                                                  struct list_head *a,
+                                                  struct list_head *b)
+{
+    struct list_head *head = NULL, **tail = &head;
+
+    for (;;) {
+        if (cmp(priv, a, b) <= 0) {
+            *tail = a;
+            tail = &a->next;
+            a = a->next;
+            if (!a) {
+                *tail = b;
+                break;
+            }
+        } else {
+            *tail = b;
+            tail = &b->next;
+            b = b->next;
+            if (!b) {
+                *tail = a;
+                break;
+            }
+        }
+    }
+
+    return head;
+}
+
+/**
+ * __list_merge_final() - Merge two sorted lists back into a list head
+ * @priv: private data for @cmp
+ * @cmp: comparison callback
+ * @head: pointer to the head of the resulting list
+ * @a: first null-terminated list, whose nodes win ties
+ * @b: second null-terminated list
+ *
+ * Unlike __list_merge(), the prev pointers are restored on the way, so the
+ * result is a regular circular list again.
+ */
+__LIST_SORT_INLINE void __list_merge_final(void *priv,
+                                           list_cmp_func_t cmp,
+                                           struct list_head *head,
+                                           struct list_head *a,
+                                           struct list_head *b)
+{
+    struct list_head *tail = head;
+
+    for (;;) {
+        if (cmp(priv, a, b) <= 0) {
+            tail->next = a;
+            a->prev = tail;
+            tail = a;
+            a = a->next;
+            if (!a)
+                break;
+        } else {
+            tail->next = b;
+            b->prev = tail;
+            tail = b;
+            b = b->next;
+            if (!b) {
+                b = a;
+                break;
+            }
+        }
+    }
+
+    /* Splice the remainder and link it backwards */
+    tail->next = b;
+    do {
+        b->prev = tail;
+        tail = b;
+        b = b->next;
+    } while (b);
+
+    tail->next = head;
+    head->prev = tail;
+}
+
+/**
+ * list_sort() - Sort a list with a stable bottom-up merge sort
+ * @priv: private data passed to @cmp
+ * @head: pointer to the head of the list
+ * @cmp: comparison callback, see list_cmp_func_t
+ *
+ * The nodes are consumed one by one and pushed onto a stack of pending
+ * sorted runs, whose sizes are powers of two. The prev pointer of the first
+ * node of each run links to the next run on the stack. Two runs of size 2^k
+ * are merged into one of size 2^(k+1) once 2^k more nodes have been pushed
+ * after them, which the bits of the node count tell. Merges are thus kept
+ * balanced at 2:1 at worst, without recursion and without walking the list
+ * to find its middle, and the runs being merged are recent enough to still
+ * be in cache.
+ */
+__LIST_SORT_INLINE void list_sort(void *priv,
+                                  struct list_head *head,
+                                  list_cmp_func_t cmp)
+{
+    struct list_head *list = head->next, *pending = NULL;
+    size_t count = 0;
+
+    if (list == head->prev)
+        return;
+
+    /* Convert to a null-terminated singly-linked list */
+    head->prev->next = NULL;
+
+    do {
+        size_t bits;
+        struct list_head **tail = &pending;
+
+        /* Find the least-significant clear bit in count */
+        for (bits = count; bits & 1; bits >>= 1)
+            tail = &(*tail)->prev;
+
+        /* Merge the two runs just below it, unless count + 1 is a power of
+         * two, in which case there is no such pair yet.
+         */
+        if (bits) {
+            struct list_head *a = *tail, *b = a->prev;
+
+            a = __list_merge(priv, cmp, b, a);
+            a->prev = b->prev;
+            *tail = a;
+        }
+
+        /* Move one node from the input onto the stack as a run of one */
+        list->prev = pending;
+        pending = list;
+        list = list->next;
+        pending->next = NULL;
+        count++;
+    } while (list);
+
+    /* Merge all pending runs, newest first */
+    list = pending;
+    pending = pending->prev;
+    for (;;) {
+        struct list_head *next = pending->prev;
+
+        if (!next)
+            break;
+        list = __list_merge(priv, cmp, pending, list);
+        pending = next;
+    }
+
+    __list_merge_final(priv, cmp, head, pending, list);
+}
+
 /**
  * list_entry() - Get the entry for this node
  * @node: pointer to list node
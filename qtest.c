@@ -1,6 +1,7 @@
 /* Implementation of testing code for queue code */
 
 #include <assert.h>
+#include <ctype.h>
 #include <errno.h>
 #include <getopt.h>
 #include <signal.h>
@@ -25,6 +26,7 @@
 
 /* Shannon entropy */
 extern double shannon_entropy(const uint8_t *input_data);
+extern double shannon_entropy_n(const uint8_t *input_data, size_t count);
 extern int show_entropy;
 
 /* Our program needs to use regular malloc/free */
@@ -46,6 +48,7 @@ extern int show_entropy;
 
 #include "console.h"
 #include "report.h"
+#include "simd_cmp.h"
 
 /* Settable parameters */
 
@@ -73,6 +76,63 @@ static int fail_count = 0;
 
 static int string_length = MAXSTRING;
 
+/* When nonzero, values are read and shown with escapes, \xHH for any byte and
+ * \\ for a backslash, so that they may hold null bytes
+ */
+static int escape_mode = 0;
+
+static int hex_digit(char c)
+{
+    if (c >= '0' && c <= '9')
+        return c - '0';
+    c = tolower((unsigned char) c);
+    return c >= 'a' && c <= 'f' ? c - 'a' + 10 : -1;
+}
+
+/* Decode the escapes of @s in place, storing the number of bytes in @len */
+static bool unescape(char *s, size_t *len)
+{
+    size_t n = 0;
+    for (const char *p = s; *p; n++) {
+        if (*p != '\\') {
+            s[n] = *p++;
+        } else if (p[1] == '\\') {
+            s[n] = '\\';
+            p += 2;
+        } else if (p[1] == 'x' && hex_digit(p[2]) >= 0 &&
+                   hex_digit(p[3]) >= 0) {
+            s[n] = hex_digit(p[2]) << 4 | hex_digit(p[3]);
+            p += 4;
+        } else {
+            report(1, "Invalid escape in '%s'", p);
+            return false;
+        }
+    }
+    s[n] = '\0';
+    *len = n;
+    return true;
+}
+
+/* Escape the @len bytes at @s into a string to be freed, NULL on failure */
+static char *escape(const char *s, size_t len)
+{
+    char *buf = malloc(4 * len + 1), *p = buf;
+    if (!buf)
+        return NULL;
+
+    for (size_t i = 0; i < len; i++) {
+        unsigned char c = s[i];
+        if (c == '\\')
+            p += sprintf(p, "\\\\");
+        else if (isprint(c) && c != ' ')
+            *p++ = c;
+        else
+            p += sprintf(p, "\\x%02x", c);
+    }
+    *p = '\0';
+    return buf;
+}
+
 #define MIN_RANDSTR_LEN 5
 #define MAX_RANDSTR_LEN 10
 static const char charset[] = "abcdefghijklmnopqrstuvwxyz";
@@ -126,14 +186,25 @@ static bool do_free(int argc, char *argv[])
 
     q_show(3);
 
-    size_t bcnt = allocation_check();
-    if (!chain.size && bcnt > 0) {
+    /* Only check for leaks once the last queue is gone, as the check has to
+     * wait for memory being freed in background
+     */
+    size_t bcnt = chain.size ? 0 : allocation_check();
+    if (bcnt > 0) {
         report(1,
                "ERROR: There is no queue, but %lu blocks are still allocated",
                bcnt);
         ok = false;
     }
 
+    size_t rcnt = chain.size ? 0 : q_mapped_regions();
+    if (rcnt > 0) {
+        report(1,
+               "ERROR: There is no queue, but %zu regions are still mapped",
+               rcnt);
+        ok = false;
+    }
+
     return ok && !error_check();
 }
 
@@ -198,7 +269,7 @@ static bool queue_insert(position_t pos, int argc, char *argv[])
 
     char *lasts = NULL;
     char randstr_buf[MAX_RANDSTR_LEN];
-    int reps = 1;
+    size_t reps = 1;
     bool ok = true, need_rand = false;
     if (argc != 2 && argc != 3) {
         report(1, "%s needs 1-2 arguments", argv[0]);
@@ -207,16 +278,20 @@ static bool queue_insert(position_t pos, int argc, char *argv[])
 
     char *inserts = argv[1];
     if (argc == 3) {
-        if (!get_int(argv[2], &reps)) {
+        if (!get_size(argv[2], &reps)) {
             report(1, "Invalid number of insertions '%s'", argv[2]);
             return false;
         }
     }
 
+    size_t len = 0;
     if (!strcmp(inserts, "RAND")) {
         need_rand = true;
         inserts = randstr_buf;
+    } else if (escape_mode && !unescape(inserts, &len)) {
+        return false;
     }
+    bool binary = escape_mode && !need_rand;
 
     if (!current || !current->q)
         report(3, "Warning: Calling insert %s on null queue",
@@ -224,11 +299,17 @@ static bool queue_insert(position_t pos, int argc, char *argv[])
     error_check();
 
     if (current && exception_setup(true)) {
-        for (int r = 0; ok && r < reps; r++) {
+        for (size_t r = 0; ok && r < reps; r++) {
             if (need_rand)
                 fill_rand_string(randstr_buf, sizeof(randstr_buf));
-            bool rval = pos == POS_TAIL ? q_insert_tail(current->q, inserts)
-                                        : q_insert_head(current->q, inserts);
+            bool rval;
+            if (binary)
+                rval = pos == POS_TAIL
+                           ? q_insert_tail_n(current->q, inserts, len)
+                           : q_insert_head_n(current->q, inserts, len);
+            else
+                rval = pos == POS_TAIL ? q_insert_tail(current->q, inserts)
+                                       : q_insert_head(current->q, inserts);
             if (rval) {
                 current->size++;
                 element_t *entry =
@@ -245,7 +326,7 @@ static bool queue_insert(position_t pos, int argc, char *argv[])
                            "queue element");
                     ok = false;
                     break;
-                } else if (r == 1 && lasts == cur_inserts) {
+                } else if (r == 1 && lasts == cur_inserts && !intern_mode) {
                     report(1,
                            "ERROR: Need to allocate separate string for each "
                            "queue element");
@@ -331,7 +412,17 @@ static bool queue_remove(position_t pos, int argc, char *argv[])
 
     bool check = argc > 1;
     bool ok = true;
-    if (check) {
+    size_t check_len = 0;
+    if (check && escape_mode) {
+        if (!unescape(argv[1], &check_len)) {
+            free(removes);
+            free(checks);
+            return false;
+        }
+        if (check_len > (size_t) string_length)
+            check_len = string_length;
+        memcpy(checks, argv[1], check_len);
+    } else if (check) {
         strncpy(checks, argv[1], string_length + 1);
         checks[string_length] = '\0';
     }
@@ -345,22 +436,38 @@ static bool queue_remove(position_t pos, int argc, char *argv[])
                pos == POS_TAIL ? "tail" : "head");
     error_check();
 
+    /* Binary values are copied without a null byte, at most string_length */
     element_t *re = NULL;
-    if (current && exception_setup(true))
-        re = pos == POS_TAIL
-                 ? q_remove_tail(current->q, removes, string_length + 1)
-                 : q_remove_head(current->q, removes, string_length + 1);
+    size_t len = 0;
+    if (current && exception_setup(true)) {
+        if (escape_mode)
+            re = pos == POS_TAIL ? q_remove_tail_n(current->q, removes,
+                                                   string_length, &len)
+                                 : q_remove_head_n(current->q, removes,
+                                                   string_length, &len);
+        else
+            re = pos == POS_TAIL
+                     ? q_remove_tail(current->q, removes, string_length + 1)
+                     : q_remove_head(current->q, removes, string_length + 1);
+    }
     exception_cancel();
+    size_t copied = len < (size_t) string_length ? len : string_length;
 
     bool is_null = re ? false : true;
 
     if (!is_null) {
+        size_t expected_len = element_len(re);
+
         // q_remove_head and q_remove_tail are not responsible for releasing
         // node
         q_release_element(re);
 
         removes[string_length + STRINGPAD] = '\0';
-        if (removes[0] == '\0') {
+        if (escape_mode && len != expected_len) {
+            report(1, "ERROR: Removed value has length %zu, expected %zu", len,
+                   expected_len);
+            ok = false;
+        } else if (!escape_mode && removes[0] == '\0') {
             report(1, "ERROR: Failed to store removed value");
             ok = false;
         }
@@ -368,7 +475,7 @@ static bool queue_remove(position_t pos, int argc, char *argv[])
         /* Check whether padding in array removes are still initial value 'X'.
          * If there's other character in padding, it's overflowed.
          */
-        int i = string_length + 1;
+        int i = escape_mode ? string_length : string_length + 1;
         while ((i < string_length + STRINGPAD) && (removes[i] == 'X'))
             i++;
         if (i != string_length + STRINGPAD) {
@@ -376,6 +483,10 @@ static bool queue_remove(position_t pos, int argc, char *argv[])
                    "ERROR: copying of string in remove_head overflowed "
                    "destination buffer.");
             ok = false;
+        } else if (escape_mode) {
+            char *shown = escape(removes, copied);
+            report(2, "Removed %s from queue", shown ? shown : "?");
+            free(shown);
         } else {
             report(2, "Removed %s from queue", removes);
         }
@@ -391,7 +502,16 @@ static bool queue_remove(position_t pos, int argc, char *argv[])
         }
     }
 
-    if (ok && check && strcmp(removes, checks)) {
+    if (ok && check && escape_mode &&
+        (copied != check_len || memcmp(removes, checks, copied))) {
+        char *shown = escape(removes, copied);
+        char *wanted = escape(checks, check_len);
+        report(1, "ERROR: Removed value %s != expected value %s",
+               shown ? shown : "?", wanted ? wanted : "?");
+        free(shown);
+        free(wanted);
+        ok = false;
+    } else if (ok && check && !escape_mode && strcmp(removes, checks)) {
         report(1, "ERROR: Removed value %s != expected value %s", removes,
                checks);
         ok = false;
@@ -414,6 +534,88 @@ static inline bool do_rt(int argc, char *argv[])
     return queue_remove(POS_TAIL, argc, argv);
 }
 
+/* Checks compare values with simd_memcmp(), over the lengths kept by the
+ * elements, rather than scanning them for a null byte first
+ */
+static int value_cmp(const element_t *a, const element_t *b)
+{
+    size_t la = element_len(a), lb = element_len(b);
+    int cmp = simd_memcmp(a->value, b->value, la < lb ? la : lb);
+    return cmp ? cmp : (la > lb) - (la < lb);
+}
+
+static int cmp_value(const void *p1, const void *p2)
+{
+    return value_cmp(*(element_t *const *) p1, *(element_t *const *) p2);
+}
+
+/* Copies of elements kept for checking, their value preceded by its length
+ * like the long values of a queue, so that element_len() applies to them
+ */
+static element_t *element_copy(const element_t *e)
+{
+    size_t len = element_len(e);
+    element_t *copy = malloc(sizeof(element_t));
+    size_t *header = malloc(sizeof(size_t) + len + 1);
+    if (!copy || !header) {
+        free(copy);
+        free(header);
+        return NULL;
+    }
+
+    *header = len;
+    copy->value = memcpy(header + 1, e->value, len + 1);
+    INIT_LIST_HEAD(&copy->list);
+    return copy;
+}
+
+static void element_copy_free(element_t *copy)
+{
+    free((size_t *) (void *) copy->value - 1);
+    free(copy);
+}
+
+/* With dedup_unsorted_mode, the queue has to hold exactly the values which
+ * occur once in l_copy, in the same order
+ */
+static bool dedup_unsorted_check(struct list_head *l_copy)
+{
+    size_t n = 0;
+    element_t *item;
+    list_for_each_entry (item, l_copy, list)
+        n++;
+
+    element_t **values = malloc((n ? n : 1) * sizeof(element_t *));
+    if (!values) {
+        report(1, "INTERNAL ERROR.  Could not allocate space for checking");
+        return false;
+    }
+
+    n = 0;
+    list_for_each_entry (item, l_copy, list)
+        values[n++] = item;
+    qsort(values, n, sizeof(element_t *), cmp_value);
+
+    bool ok = true;
+    struct list_head *l_tmp = current->q->next;
+    list_for_each_entry (item, l_copy, list) {
+        element_t **found =
+            bsearch(&item, values, n, sizeof(element_t *), cmp_value);
+        bool is_dup = (found > values && !value_cmp(found[-1], item)) ||
+                      (found < values + n - 1 && !value_cmp(found[1], item));
+        if (is_dup)
+            current->size--;
+        else if (l_tmp != current->q &&
+                 !value_cmp(list_entry(l_tmp, element_t, list), item))
+            l_tmp = l_tmp->next;
+        else
+            ok = false;
+    }
+    free(values);
+
+    return ok && l_tmp == current->q;
+}
+
 static bool do_dedup(int argc, char *argv[])
 {
     if (argc != 1) {
@@ -432,26 +634,15 @@ static bool do_dedup(int argc, char *argv[])
     // Copy current->q to l_copy
     if (current->q && !list_empty(current->q)) {
         list_for_each_entry (item, current->q, list) {
-            size_t slen;
-            tmp = malloc(sizeof(element_t));
+            tmp = element_copy(item);
             if (!tmp)
                 break;
-            INIT_LIST_HEAD(&tmp->list);
-            slen = strlen(item->value) + 1;
-            tmp->value = malloc(slen);
-            if (!tmp->value) {
-                free(tmp);
-                break;
-            }
-            memcpy(tmp->value, item->value, slen);
             list_add_tail(&tmp->list, &l_copy);
         }
         // Return false if the loop does not leave properly
         if (&item->list != current->q) {
-            list_for_each_entry_safe (item, tmp, &l_copy, list) {
-                free(item->value);
-                free(item);
-            }
+            list_for_each_entry_safe (item, tmp, &l_copy, list)
+                element_copy_free(item);
             report(1,
                    "INTERNAL ERROR.  Could not allocate space for "
                    "duplicate checking");
@@ -464,46 +655,54 @@ static bool do_dedup(int argc, char *argv[])
         ok = q_delete_dup(current->q);
     exception_cancel();
 
+    /* q_delete_dup() returns false for fewer than two elements, which leaves
+     * nothing to delete. The unsorted mode takes that as success.
+     */
+    if (!ok && dedup_unsorted_mode && current->size <= 1)
+        ok = true;
+
     if (!ok) {
-        list_for_each_entry_safe (item, tmp, &l_copy, list) {
-            free(item->value);
-            free(item);
-        }
-        report(1, "ERROR: Calling delete duplicate on null queue");
+        list_for_each_entry_safe (item, tmp, &l_copy, list)
+            element_copy_free(item);
+        if (dedup_unsorted_mode)
+            report(1, "ERROR: Could not delete duplicates from unsorted queue");
+        else
+            report(1, "ERROR: Calling delete duplicate on null queue");
         return false;
     }
 
-    struct list_head *l_tmp = current->q->next;
-    bool is_this_dup = false;
-    // Compare between new list and old one
-    list_for_each_entry (item, &l_copy, list) {
-        // Skip comparison with new list if the string is duplicate
-        bool is_next_dup =
-            item->list.next != &l_copy &&
-            strcmp(list_entry(item->list.next, element_t, list)->value,
-                   item->value) == 0;
-        if (is_this_dup || is_next_dup) {
-            // Update list size
-            current->size--;
-        } else if (l_tmp != current->q &&
-                   strcmp(list_entry(l_tmp, element_t, list)->value,
-                          item->value) == 0)
-            l_tmp = l_tmp->next;
-        else
-            ok = false;
-        is_this_dup = is_next_dup;
+    if (dedup_unsorted_mode) {
+        ok = dedup_unsorted_check(&l_copy);
+    } else {
+        struct list_head *l_tmp = current->q->next;
+        bool is_this_dup = false;
+        // Compare between new list and old one
+        list_for_each_entry (item, &l_copy, list) {
+            // Skip comparison with new list if the string is duplicate
+            bool is_next_dup =
+                item->list.next != &l_copy &&
+                !value_cmp(list_entry(item->list.next, element_t, list), item);
+            if (is_this_dup || is_next_dup) {
+                // Update list size
+                current->size--;
+            } else if (l_tmp != current->q &&
+                       !value_cmp(list_entry(l_tmp, element_t, list), item))
+                l_tmp = l_tmp->next;
+            else
+                ok = false;
+            is_this_dup = is_next_dup;
+        }
+        // All elements in new list should be traversed
+        ok = ok && l_tmp == current->q;
     }
-    // All elements in new list should be traversed
-    ok = ok && l_tmp == current->q;
+
     if (!ok)
         report(1,
                "ERROR: Duplicate strings are in queue or distinct strings are "
                "not in queue");
 
-    list_for_each_entry_safe (item, tmp, &l_copy, list) {
-        free(item->value);
-        free(item);
-    }
+    list_for_each_entry_safe (item, tmp, &l_copy, list)
+        element_copy_free(item);
 
     q_show(3);
     return ok && !error_check();
@@ -537,7 +736,7 @@ static bool do_size(int argc, char *argv[])
         return false;
     }
 
-    int reps = 1;
+    size_t reps = 1;
     bool ok = true;
     if (argc != 1 && argc != 2) {
         report(1, "%s needs 0-1 arguments", argv[0]);
@@ -545,17 +744,17 @@ static bool do_size(int argc, char *argv[])
     }
 
     if (argc == 2) {
-        if (!get_int(argv[1], &reps))
-            report(1, "Invalid number of calls to size '%s'", argv[2]);
+        if (!get_size(argv[1], &reps))
+            report(1, "Invalid number of calls to size '%s'", argv[1]);
     }
 
-    int cnt = 0;
+    size_t cnt = 0;
     if (!current || !current->q)
         report(3, "Warning: Calling size on null queue");
     error_check();
 
     if (current && exception_setup(true)) {
-        for (int r = 0; ok && r < reps; r++) {
+        for (size_t r = 0; ok && r < reps; r++) {
             cnt = q_size(current->q);
             ok = ok && !error_check();
         }
@@ -564,11 +763,12 @@ static bool do_size(int argc, char *argv[])
 
     if (current && ok) {
         if (current->size == cnt) {
-            report(2, "Queue size = %d", cnt);
+            report(2, "Queue size = %zu", cnt);
         } else {
             report(1,
-                   "ERROR: Computed queue size as %d, but correct value is %d",
-                   cnt, (int) current->size);
+                   "ERROR: Computed queue size as %zu, but correct value is "
+                   "%zu",
+                   cnt, current->size);
             ok = false;
         }
     }
@@ -578,6 +778,69 @@ static bool do_size(int argc, char *argv[])
     return ok && !error_check();
 }
 
+/* Digits compare by the value of their runs, the rest byte by byte */
+static int numeric_cmp(const char *a, const char *b)
+{
+    const char *x = a, *y = b;
+    while (*x && *y) {
+        if (isdigit((unsigned char) *x) && isdigit((unsigned char) *y)) {
+            x += strspn(x, "0");
+            y += strspn(y, "0");
+            size_t lx = strspn(x, "0123456789");
+            size_t ly = strspn(y, "0123456789");
+            if (lx != ly)
+                return lx < ly ? -1 : 1;
+            int cmp = strncmp(x, y, lx);
+            if (cmp)
+                return cmp;
+            x += lx;
+            y += ly;
+        } else if (*x != *y) {
+            return (unsigned char) *x < (unsigned char) *y ? -1 : 1;
+        } else {
+            x++;
+            y++;
+        }
+    }
+
+    if (*x || *y)
+        return *x ? 1 : -1;
+    return strcmp(a, b);
+}
+
+/* The order set by "option order", which sort, merge and descend follow */
+static int order_cmp(const element_t *a, const element_t *b)
+{
+    switch (sort_order) {
+    case ORDER_DESCEND:
+        return value_cmp(b, a);
+    case ORDER_LENGTH: {
+        size_t la = element_len(a), lb = element_len(b);
+        if (la != lb)
+            return la < lb ? -1 : 1;
+        break;
+    }
+    case ORDER_NUMERIC:
+        return numeric_cmp(a->value, b->value);
+    }
+
+    return value_cmp(a, b);
+}
+
+static const char *order_name(void)
+{
+    static const char *const names[] = {
+        [ORDER_ASCEND] = "ascending",
+        [ORDER_DESCEND] = "descending",
+        [ORDER_LENGTH] = "length",
+        [ORDER_NUMERIC] = "numeric",
+    };
+
+    if (sort_order < 0 || sort_order > ORDER_NUMERIC)
+        return names[ORDER_ASCEND];
+    return names[sort_order];
+}
+
 bool do_sort(int argc, char *argv[])
 {
     if (argc != 1) {
@@ -585,7 +848,7 @@ bool do_sort(int argc, char *argv[])
         return false;
     }
 
-    int cnt = 0;
+    size_t cnt = 0;
     if (!current || !current->q)
         report(3, "Warning: Calling sort on null queue");
     else
@@ -607,12 +870,11 @@ bool do_sort(int argc, char *argv[])
         for (struct list_head *cur_l = current->q->next;
              cur_l != current->q && --cnt; cur_l = cur_l->next) {
             /* Ensure each element in ascending order */
-            /* FIXME: add an option to specify sorting order */
             element_t *item, *next_item;
             item = list_entry(cur_l, element_t, list);
             next_item = list_entry(cur_l->next, element_t, list);
-            if (strcmp(item->value, next_item->value) > 0) {
-                report(1, "ERROR: Not sorted in ascending order");
+            if (order_cmp(item, next_item) > 0) {
+                report(1, "ERROR: Not sorted in %s order", order_name());
                 ok = false;
                 break;
             }
@@ -688,7 +950,7 @@ static bool do_descend(int argc, char *argv[])
     error_check();
 
 
-    int cnt = q_size(current->q);
+    size_t cnt = q_size(current->q);
     if (!cnt)
         report(3, "Warning: Calling descend on empty queue");
     else if (cnt < 2)
@@ -708,7 +970,7 @@ static bool do_descend(int argc, char *argv[])
             element_t *item, *next_item;
             item = list_entry(cur_l, element_t, list);
             next_item = list_entry(cur_l->next, element_t, list);
-            if (strcmp(item->value, next_item->value) < 0) {
+            if (order_cmp(item, next_item) < 0) {
                 report(1,
                        "ERROR: At least one node violated the ordering rule");
                 ok = false;
@@ -723,7 +985,7 @@ static bool do_descend(int argc, char *argv[])
 
 static bool do_reverseK(int argc, char *argv[])
 {
-    int k = 0;
+    size_t k = 0;
 
     if (!current || !current->q) {
         report(3, "Warning: Calling reverseK on null queue");
@@ -732,7 +994,7 @@ static bool do_reverseK(int argc, char *argv[])
     error_check();
 
     if (argc == 2) {
-        if (!get_int(argv[1], &k)) {
+        if (!get_size(argv[1], &k)) {
             report(1, "Invalid number of K");
             return false;
         }
@@ -751,6 +1013,69 @@ static bool do_reverseK(int argc, char *argv[])
     return !error_check();
 }
 
+static bool do_topk(int argc, char *argv[])
+{
+    size_t k = 0;
+
+    if (!current || !current->q) {
+        report(3, "Warning: Calling topk on null queue");
+        return false;
+    }
+    error_check();
+
+    if (argc == 2) {
+        if (!get_size(argv[1], &k)) {
+            report(1, "Invalid number of K");
+            return false;
+        }
+    } else {
+        report(1, "Invalid number of arguments for topk");
+        return false;
+    }
+
+    set_noallocate_mode(true);
+    if (exception_setup(true))
+        q_topk(current->q, k, sort_order);
+    exception_cancel();
+    set_noallocate_mode(false);
+
+    /* q_size() is a stored count, so count the nodes linked */
+    bool ok = true;
+    size_t len = 0;
+    struct list_head *node;
+    list_for_each (node, current->q)
+        len++;
+    if (len != current->size) {
+        report(1, "ERROR: Queue has %zu elements, expected %zu", len,
+               current->size);
+        ok = false;
+    }
+
+    /* The first K in order, none of the rest before the last of them */
+    size_t cnt = k < current->size ? k : current->size;
+    element_t *last = NULL, *item;
+    list_for_each_entry (item, current->q, list) {
+        if (!ok)
+            break;
+        if (cnt) {
+            if (last && order_cmp(last, item) > 0) {
+                report(1, "ERROR: Top %zu not sorted in %s order", k,
+                       order_name());
+                ok = false;
+            }
+            last = item;
+            cnt--;
+        } else if (last && order_cmp(item, last) < 0) {
+            report(1, "ERROR: Element after the top %zu precedes them in %s "
+                   "order", k, order_name());
+            ok = false;
+        }
+    }
+
+    q_show(3);
+    return ok && !error_check();
+}
+
 static bool do_merge(int argc, char *argv[])
 {
     if (argc != 1) {
@@ -764,14 +1089,14 @@ static bool do_merge(int argc, char *argv[])
     }
     error_check();
 
-    int len = 0;
+    size_t len = 0;
     set_noallocate_mode(true);
     if (current && exception_setup(true))
         len = q_merge(&chain.head);
     exception_cancel();
     set_noallocate_mode(false);
 
-    if (q_size(&chain.head) > 1) {
+    if (chain.size > 1) {
         chain.size = 1;
         current = list_entry(chain.head.next, queue_contex_t, chain);
         current->size = len;
@@ -796,11 +1121,12 @@ static bool do_merge(int argc, char *argv[])
             element_t *item, *next_item;
             item = list_entry(cur_l, element_t, list);
             next_item = list_entry(cur_l->next, element_t, list);
-            if (strcmp(item->value, next_item->value) > 0) {
+            if (order_cmp(item, next_item) > 0) {
                 report(1,
-                       "ERROR: Not sorted in ascending order (It might because "
+                       "ERROR: Not sorted in %s order (It might because "
                        "of unsorted queues are merged or there're some flaws "
-                       "in 'q_merge')");
+                       "in 'q_merge')",
+                       order_name());
                 ok = false;
                 break;
             }
@@ -811,6 +1137,31 @@ static bool do_merge(int argc, char *argv[])
     return ok && !error_check();
 }
 
+static bool do_compact(int argc, char *argv[])
+{
+    if (argc != 1) {
+        report(1, "%s takes no arguments", argv[0]);
+        return false;
+    }
+
+    if (!current || !current->q) {
+        report(3, "Warning: Calling compact on null queue");
+        return false;
+    }
+    error_check();
+
+    bool ok = true;
+    if (exception_setup(true))
+        ok = q_compact(current->q);
+    exception_cancel();
+
+    if (!ok)
+        report(1, "ERROR: Could not compact queue");
+
+    q_show(3);
+    return ok && !error_check();
+}
+
 static bool is_circular()
 {
     struct list_head *cur = current->q->next;
@@ -835,7 +1186,7 @@ static bool q_show(int vlevel)
     if (verblevel < vlevel)
         return true;
 
-    int cnt = 0;
+    size_t cnt = 0;
     if (!current || !current->q) {
         report(vlevel, "l = NULL");
         return true;
@@ -855,11 +1206,16 @@ static bool q_show(int vlevel)
         while (ok && ori != cur && cnt < current->size) {
             element_t *e = list_entry(cur, element_t, list);
             if (cnt < BIG_LIST_SIZE) {
-                report_noreturn(vlevel, cnt == 0 ? "%s" : " %s", e->value);
+                char *shown =
+                    escape_mode ? escape(e->value, element_len(e)) : NULL;
+                report_noreturn(vlevel, cnt == 0 ? "%s" : " %s",
+                                shown ? shown : e->value);
+                free(shown);
                 if (show_entropy) {
                     report_noreturn(
                         vlevel, "(%3.2f%%)",
-                        shannon_entropy((const uint8_t *) e->value));
+                        shannon_entropy_n((const uint8_t *) e->value,
+                                          element_len(e)));
                 }
             }
             cnt++;
@@ -881,7 +1237,7 @@ static bool q_show(int vlevel)
             report(vlevel, " ... ]");
     } else {
         report(vlevel, " ... ]");
-        report(vlevel, "ERROR:  Queue has more than %d elements",
+        report(vlevel, "ERROR:  Queue has more than %zu elements",
                current->size);
         ok = false;
     }
@@ -898,6 +1254,8 @@ static bool do_show(int argc, char *argv[])
 
     if (current)
         report(1, "Current queue ID: %d", current->id);
+    if (q_mapped_regions())
+        report(1, "Huge page regions in use: %zu", q_mapped_regions());
 
     return q_show(0);
 }
@@ -984,12 +1342,44 @@ static void console_init()
                 "");
     ADD_COMMAND(reverseK, "Reverse the nodes of the queue 'K' at a time",
                 "[K]");
+    ADD_COMMAND(topk,
+                "Move the K least nodes to the front of queue in sort order",
+                "K");
+    ADD_COMMAND(compact,
+                "Move queue elements into contiguous memory in list order", "");
     add_param("length", &string_length, "Maximum length of displayed string",
               NULL);
     add_param("malloc", &fail_probability, "Malloc failure probability percent",
               NULL);
     add_param("fail", &fail_limit,
               "Number of times allow queue operations to return false", NULL);
+    add_param("intern", &intern_mode,
+              "Share storage of equal strings that do not fit into element",
+              NULL);
+    add_param("hugepage", &huge_page_mode,
+              "Allocate large slabs of elements on transparent huge pages",
+              NULL);
+    add_param("escape", &escape_mode,
+              "Read and show values with \\xHH escapes, null bytes included",
+              NULL);
+    add_param("unsorted", &dedup_unsorted_mode,
+              "Remove duplicates anywhere in the queue in dedup", NULL);
+    add_param("sortalgo", &sort_algorithm,
+              "Sort algorithm: 0 natural merge, 1 bottom-up, 2 radix", NULL);
+    add_param("threads", &sort_threads,
+              "Number of threads used by sort and merge", NULL);
+    add_param("order", &sort_order,
+              "Sort order: 0 ascending, 1 descending, 2 length, 3 numeric",
+              NULL);
+    add_param("sortmem", &sort_memory_limit,
+              "Megabytes of scratch memory for radix sort, 0 for no limit",
+              NULL);
+    add_param("async", &async_free_mode,
+              "Free memory released by free, dedup and descend in background",
+              NULL);
+    add_param("timeout", &time_limit,
+              "Time limit of each queue operation in seconds, 0 for none",
+              NULL);
 }
 
 /* Signal handlers */
@@ -1047,6 +1437,13 @@ static bool q_quit(int argc, char *argv[])
         return false;
     }
 
+    size_t rcnt = q_mapped_regions();
+    if (rcnt > 0) {
+        report(1, "ERROR: Freed queue, but %zu regions are still mapped",
+               rcnt);
+        return false;
+    }
+
     return true;
 }
 
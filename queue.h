@@ -9,22 +9,160 @@
 
 #include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
 
 #include "harness.h"
 #include "list.h"
 
+/* Strings up to this size, including the terminating null byte, are stored
+ * inside the element itself. It is chosen so that element_t takes 40 bytes on
+ * 64-bit platforms.
+ */
+#define ELEMENT_INLINE_SIZE 12
+
 /**
  * element_t - Linked list element
  * @value: pointer to array holding string
  * @list: node of a doubly-linked list
+ * @inline_value: storage for short strings
+ * @index: position of this element in the slab it is carved from
+ *
+ * @value points to @inline_value when the string fits into it, so that short
+ * strings need no allocation other than the element. Longer strings are
+ * explicitly allocated and freed, or shared when intern_mode is set, and
+ * @inline_value keeps a copy of their first bytes. Either way, @inline_value
+ * starts with the first 8 bytes of the string, padded with null bytes, right
+ * next to @list, which lets comparisons skip loading most strings.
  *
- * @value needs to be explicitly allocated and freed
+ * Values may hold any bytes, including null ones, and always have a null byte
+ * past their end. Their length is kept alongside, see element_len().
  */
 typedef struct {
     char *value;
     struct list_head list;
+    char inline_value[ELEMENT_INLINE_SIZE];
+    uint32_t index;
 } element_t;
 
+/**
+ * element_is_inline() - Check whether the string is stored in the element
+ * @e: the element
+ *
+ * Return: true if @e->value points to @e->inline_value
+ */
+static inline bool element_is_inline(const element_t *e)
+{
+    return e->value == e->inline_value;
+}
+
+/**
+ * element_len() - Get the length of the value of an element
+ * @e: the element
+ *
+ * The last byte of @e->inline_value holds the number of bytes a value stored
+ * there leaves unused, so that it doubles as the null byte of the longest
+ * ones. Longer values are preceded by their length.
+ *
+ * Return: the number of bytes in @e->value, not counting the final null byte
+ */
+static inline size_t element_len(const element_t *e)
+{
+    if (element_is_inline(e))
+        return ELEMENT_INLINE_SIZE - 1 -
+               (unsigned char) e->inline_value[ELEMENT_INLINE_SIZE - 1];
+    return ((const size_t *) (const void *) e->value)[-1];
+}
+
+/**
+ * q_arena_t - Storage owned by a queue, which its elements are carved from
+ * @slabs: list of slabs, the most recently allocated one first
+ * @free: released elements, ready to be reused by the next insertion
+ * @n_heap: number of elements in use whose string is allocated separately
+ */
+typedef struct {
+    struct list_head slabs;
+    struct list_head free;
+    size_t n_heap;
+} q_arena_t;
+
+/**
+ * queue_t - Header of a queue
+ * @head: head of the doubly-linked list of elements
+ * @size: the number of elements in the queue
+ * @arena: storage of the elements
+ *
+ * q_new() returns a pointer to @head. Every operation that adds or removes
+ * elements keeps @size up to date, so that q_size() does not have to walk the
+ * list.
+ */
+typedef struct {
+    struct list_head head;
+    size_t size;
+    q_arena_t arena;
+} queue_t;
+
+/* When nonzero, equal strings which do not fit into an element share a single
+ * reference-counted copy instead of being duplicated for every element.
+ */
+extern int intern_mode;
+
+/* When nonzero, large slabs of elements are allocated from memory regions
+ * mapped for transparent huge pages rather than with malloc.
+ */
+extern int huge_page_mode;
+
+/* When nonzero, q_free(), q_delete_dup() and q_descend() leave freeing the
+ * released memory to a background thread of the harness.
+ */
+extern int async_free_mode;
+
+/* When nonzero, q_delete_dup() removes duplicates from unsorted queues too */
+extern int dedup_unsorted_mode;
+
+/* Algorithms of q_sort() and q_merge() */
+enum {
+    SORT_NATURAL,   /* merge sort of the runs found in the queue, the default */
+    SORT_BOTTOM_UP, /* list_sort() of list.h */
+    SORT_RADIX,     /* MSD radix sort of an array of the elements */
+};
+
+/* One of the algorithms above */
+extern int sort_algorithm;
+
+#define SORT_MAX_THREADS 64
+
+/* Number of threads q_sort() and q_merge() may use, up to SORT_MAX_THREADS */
+extern int sort_threads;
+
+/* Megabytes of scratch memory the radix sort may use, 0 for no limit. Larger
+ * queues are sorted in runs within the limit, merged in a single pass.
+ */
+extern int sort_memory_limit;
+
+/* Orders of q_sort(), q_merge(), q_descend() and q_topk(). The radix sort
+ * only handles the first, q_sort() merges for the others.
+ */
+enum {
+    ORDER_ASCEND,  /* byte by byte, like strcmp(), the default */
+    ORDER_DESCEND, /* the reverse of the above */
+    ORDER_LENGTH,  /* shorter values first, then byte by byte */
+    ORDER_NUMERIC, /* runs of digits by their value, other bytes as they are */
+};
+
+/* One of the orders above, which "ascending" means in q_sort(), q_merge() and
+ * q_descend()
+ */
+extern int sort_order;
+
+/**
+ * q_mapped_regions() - Get the number of memory regions mapped for slabs
+ *
+ * Those regions are not accounted for by the test harness.
+ *
+ * Return: the number of regions currently in use by all queues
+ */
+size_t q_mapped_regions();
+
 /**
  * queue_contex_t - The context managing a chain of queues
  * @q: pointer to the head of the queue
@@ -35,7 +173,7 @@ typedef struct {
 typedef struct {
     struct list_head *q;
     struct list_head chain;
-    int size;
+    size_t size;
     int id;
 } queue_contex_t;
 
@@ -51,6 +189,9 @@ struct list_head *q_new();
 /**
  * q_free() - Free all storage used by queue, no effect if header is NULL
  * @head: header of queue
+ *
+ * The elements are released together with the slabs of the queue, hence any
+ * element removed from the queue must be released beforehand.
  */
 void q_free(struct list_head *head);
 
@@ -59,8 +200,11 @@ void q_free(struct list_head *head);
  * @head: header of queue
  * @s: string would be inserted
  *
- * Argument s points to the string to be stored.
- * The function must explicitly allocate space and copy the string into it.
+ * Argument s points to the null-terminated string to be stored, which the
+ * caller keeps. The string is copied into the element itself if it fits, see
+ * ELEMENT_INLINE_SIZE, into space allocated for it otherwise, or shared with
+ * an equal value when intern_mode is set. Its length is measured once and
+ * kept, see element_len().
  *
  * Return: true for success, false for allocation failed or queue is NULL
  */
@@ -71,13 +215,39 @@ bool q_insert_head(struct list_head *head, char *s);
  * @head: header of queue
  * @s: string would be inserted
  *
- * Argument s points to the string to be stored.
- * The function must explicitly allocate space and copy the string into it.
+ * Argument s points to the null-terminated string to be stored, which the
+ * caller keeps. The string is copied into the element itself if it fits, see
+ * ELEMENT_INLINE_SIZE, into space allocated for it otherwise, or shared with
+ * an equal value when intern_mode is set. Its length is measured once and
+ * kept, see element_len().
  *
  * Return: true for success, false for allocation failed or queue is NULL
  */
 bool q_insert_tail(struct list_head *head, char *s);
 
+/**
+ * q_insert_head_n() - Insert an element holding arbitrary bytes in the head
+ * @head: header of queue
+ * @buf: bytes would be inserted
+ * @len: number of bytes in @buf
+ *
+ * Unlike q_insert_head(), the value is not scanned for a null byte, and may
+ * contain some.
+ *
+ * Return: true for success, false for allocation failed or queue is NULL
+ */
+bool q_insert_head_n(struct list_head *head, const void *buf, size_t len);
+
+/**
+ * q_insert_tail_n() - Insert an element holding arbitrary bytes at the tail
+ * @head: header of queue
+ * @buf: bytes would be inserted
+ * @len: number of bytes in @buf
+ *
+ * Return: true for success, false for allocation failed or queue is NULL
+ */
+bool q_insert_tail_n(struct list_head *head, const void *buf, size_t len);
+
 /**
  * q_remove_head() - Remove the element from head of queue
  * @head: header of queue
@@ -108,25 +278,58 @@ element_t *q_remove_head(struct list_head *head, char *sp, size_t bufsize);
  */
 element_t *q_remove_tail(struct list_head *head, char *sp, size_t bufsize);
 
+/**
+ * q_remove_head_n() - Remove the element from head of queue, copying its bytes
+ * @head: header of queue
+ * @buf: buffer receiving the value, or NULL
+ * @bufsize: size of @buf
+ * @len: where to store the length of the value, or NULL
+ *
+ * The value is copied as is, up to @bufsize bytes, without a null byte added.
+ * A length greater than @bufsize means that the copy is truncated.
+ *
+ * Return: the pointer to element, %NULL if queue is NULL or empty.
+ */
+element_t *q_remove_head_n(struct list_head *head,
+                           void *buf,
+                           size_t bufsize,
+                           size_t *len);
+
+/**
+ * q_remove_tail_n() - Remove the element from tail of queue, copying its bytes
+ * @head: header of queue
+ * @buf: buffer receiving the value, or NULL
+ * @bufsize: size of @buf
+ * @len: where to store the length of the value, or NULL
+ *
+ * Return: the pointer to element, %NULL if queue is NULL or empty.
+ */
+element_t *q_remove_tail_n(struct list_head *head,
+                           void *buf,
+                           size_t bufsize,
+                           size_t *len);
+
 /**
  * q_release_element() - Release the element
  * @e: element would be released
  *
+ * The element is returned to the arena of the queue it was inserted into, so
+ * it has to be called before that queue is freed.
+ *
  * This function is intended for internal use only.
  */
-static inline void q_release_element(element_t *e)
-{
-    test_free(e->value);
-    test_free(e);
-}
+void q_release_element(element_t *e);
 
 /**
  * q_size() - Get the size of the queue
  * @head: header of queue
  *
+ * The size is tracked by the queue_t containing @head, so this function runs
+ * in constant time.
+ *
  * Return: the number of elements in queue, zero if queue is NULL or empty
  */
-int q_size(struct list_head *head);
+size_t q_size(struct list_head *head);
 
 /**
  * q_delete_mid() - Delete the middle node in queue
@@ -148,10 +351,15 @@ bool q_delete_mid(struct list_head *head);
  *                  leaving only distinct strings from the original queue.
  * @head: header of queue
  *
+ * The queue is expected to be sorted, so that equal strings are adjacent.
+ * When dedup_unsorted_mode is set, they may be anywhere instead, and are
+ * found in linear time with a hash table, at the cost of an allocation. The
+ * remaining elements keep their order either way.
+ *
  * Reference:
  * https://leetcode.com/problems/remove-duplicates-from-sorted-list-ii/
  *
- * Return: true for success, false if list is NULL.
+ * Return: true for success, false if list is NULL or allocation failed.
  */
 bool q_delete_dup(struct list_head *head);
 
@@ -188,14 +396,17 @@ void q_reverse(struct list_head *head);
  * Reference:
  * https://leetcode.com/problems/reverse-nodes-in-k-group/
  */
-void q_reverseK(struct list_head *head, int k);
+void q_reverseK(struct list_head *head, size_t k);
 
 /**
  * q_sort() - Sort elements of queue in ascending order
  * @head: header of queue
  *
  * No effect if queue is NULL or empty. If there has only one element, do
- * nothing.
+ * nothing. Ascending is in the order of sort_order, byte by byte by default.
+ * The sort is stable. With the default algorithm, it runs in linear time if
+ * the queue is sorted already, or sorted in reverse order, and gets faster as
+ * the queue consists of fewer ascending or descending runs.
  */
 void q_sort(struct list_head *head);
 
@@ -205,14 +416,14 @@ void q_sort(struct list_head *head);
  * @head: header of queue
  *
  * No effect if queue is NULL or empty. If there has only one element, do
- * nothing.
+ * nothing. Values compare in the order of sort_order.
  *
  * Reference:
  * https://leetcode.com/problems/remove-nodes-from-linked-list/
  *
  * Return: the number of elements in queue after performing operation
  */
-int q_descend(struct list_head *head);
+size_t q_descend(struct list_head *head);
 
 /**
  * q_merge() - Merge all the queues into one sorted queue, which is in ascending
@@ -220,7 +431,8 @@ int q_descend(struct list_head *head);
  * @head: header of chain
  *
  * This function merge the second to the last queues in the chain into the first
- * queue. The queues are guaranteed to be sorted before this function is called.
+ * queue. The queues are guaranteed to be sorted before this function is called,
+ * in the order of sort_order.
  * No effect if there is only one queue in the chain. Allocation is disallowed
  * in this function. There is no need to free the 'qcontext_t' and its member
  * 'q' since they will be released externally. However, q_merge() is responsible
@@ -231,6 +443,35 @@ int q_descend(struct list_head *head);
  *
  * Return: the number of elements in queue after merging
  */
-int q_merge(struct list_head *head);
+size_t q_merge(struct list_head *head);
+
+/**
+ * q_topk() - Move the K least elements to the front of queue, in order
+ * @head: header of queue
+ * @k: number of elements wanted
+ * @order: one of the orders above, ORDER_DESCEND for the K greatest values
+ *
+ * No effect if queue is NULL or empty, or if @k is zero. The first @k elements
+ * of the queue, or all of them if there are fewer, end up sorted in @order,
+ * ties in their original order. The rest follow in unspecified order. It takes
+ * O(n log k) time for n elements, with a heap of @k entries mapped outside of
+ * the allocator. Should that memory be lacking, the whole queue is sorted.
+ */
+void q_topk(struct list_head *head, size_t k, int order);
+
+/**
+ * q_compact() - Move the elements of queue into contiguous memory in list order
+ * @head: header of queue
+ *
+ * After many insertions, removals, sorts and reversals, consecutive elements
+ * end up scattered over the slabs of the queue. This function copies them into
+ * a single block in their current order and fixes up the links, so that later
+ * traversals read memory sequentially. Strings which do not fit into an
+ * element are not moved. Like q_free(), it must not be called while elements
+ * removed from the queue are yet to be released.
+ *
+ * Return: true for success, false if allocation failed or queue is NULL.
+ */
+bool q_compact(struct list_head *head);
 
 #endif /* LAB0_QUEUE_H */
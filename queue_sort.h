@@ -0,0 +1,566 @@
+/*
+ * Template of the parts of the sort, merge, descend and top-k which compare
+ * values, included by queue.c once per order. Before each inclusion, SORT_CMP
+ * names the comparison of two elements, an inline function, and SORT_SUFFIX
+ * the suffix of the functions of that order, e.g. run_merge_descend() for
+ * _descend. Every comparison is then inlined, where a comparator passed by
+ * pointer would cost an indirect call each.
+ *
+ * The functions are named plainly below, and renamed by the macros here.
+ */
+
+#define SORT_NAME(name) SORT_PASTE(name, SORT_SUFFIX)
+#define SORT_PASTE(name, suffix) SORT_PASTE_(name, suffix)
+#define SORT_PASTE_(name, suffix) name##suffix
+
+#define node_cmp SORT_NAME(node_cmp)
+#define list_cmp SORT_NAME(list_cmp)
+#define sort_bottom_up SORT_NAME(sort_bottom_up)
+#define run_take SORT_NAME(run_take)
+#define run_extend SORT_NAME(run_extend)
+#define run_gallop SORT_NAME(run_gallop)
+#define run_merge SORT_NAME(run_merge)
+#define runs_merge_at SORT_NAME(runs_merge_at)
+#define runs_less SORT_NAME(runs_less)
+#define runs_sift_down SORT_NAME(runs_sift_down)
+#define runs_merge_kway SORT_NAME(runs_merge_kway)
+#define sort_natural SORT_NAME(sort_natural)
+#define merge_path SORT_NAME(merge_path)
+#define merge_piece SORT_NAME(merge_piece)
+#define descend SORT_NAME(descend)
+#define topk_worse SORT_NAME(topk_worse)
+#define topk_sift_down SORT_NAME(topk_sift_down)
+#define topk SORT_NAME(topk)
+
+static inline int node_cmp(const struct list_head *a, const struct list_head *b)
+{
+    return SORT_CMP(list_entry(a, element_t, list),
+                    list_entry(b, element_t, list));
+}
+
+static int list_cmp(void *priv,
+                    const struct list_head *a,
+                    const struct list_head *b)
+{
+    return node_cmp(a, b);
+}
+
+/* list_sort() is inline, so the comparison is known where it is called */
+static void sort_bottom_up(struct list_head *head)
+{
+    list_sort(NULL, head, list_cmp);
+}
+
+/* Take the longest ascending or descending run at the start of @list, which
+ * begins with a strict descent in the latter case. A descending run is
+ * reversed as it is taken: every node goes in front, unless it equals the
+ * one before it, in which case it goes right after it, so that equal nodes
+ * keep their order. Returns what follows.
+ */
+static struct list_head *run_take(struct sort_run *run, struct list_head *list)
+{
+    struct list_head *prev = list, *cur = list->next;
+    int cmp = cur ? node_cmp(prev, cur) : 0;
+    run->len = 1;
+
+    if (cmp > 0) {
+        run->head = run->tail = list;
+        list->next = NULL;
+        do {
+            struct list_head *next = cur->next;
+            if (cmp) {
+                cur->next = run->head;
+                run->head->prev = cur;
+                run->head = cur;
+            } else {
+                cur->next = prev->next;
+                if (cur->next)
+                    cur->next->prev = cur;
+                else
+                    run->tail = cur;
+                prev->next = cur;
+                cur->prev = prev;
+            }
+            prev = cur;
+            cur = next;
+            run->len++;
+        } while (cur && (cmp = node_cmp(prev, cur)) >= 0);
+        return cur;
+    }
+
+    while (cur && cmp <= 0) {
+        prev = cur;
+        cur = cur->next;
+        run->len++;
+        if (cur)
+            cmp = node_cmp(prev, cur);
+    }
+    prev->next = NULL;
+    run->head = list;
+    run->tail = prev;
+    return cur;
+}
+
+/* Extend @run with the nodes following it up to @min_run nodes in total, by
+ * binary insertion into an array, which costs few comparisons and no walks.
+ * Returns what follows.
+ */
+static struct list_head *run_extend(struct sort_run *run,
+                                    struct list_head *list,
+                                    size_t min_run)
+{
+    struct list_head *v[SORT_MAX_MIN_RUN];
+    size_t n = 0;
+
+    for (struct list_head *node = run->head; node; node = node->next)
+        v[n++] = node;
+
+    for (; list && n < min_run; n++) {
+        struct list_head *node = list;
+        size_t lo = 0, hi = n;
+        list = list->next;
+
+        /* Insert after any equal nodes, for stability */
+        while (lo < hi) {
+            size_t mid = (lo + hi) / 2;
+            if (node_cmp(node, v[mid]) < 0)
+                hi = mid;
+            else
+                lo = mid + 1;
+        }
+        memmove(&v[lo + 1], &v[lo], (n - lo) * sizeof(v[0]));
+        v[lo] = node;
+    }
+
+    for (size_t i = 0; i + 1 < n; i++) {
+        v[i]->next = v[i + 1];
+        v[i + 1]->prev = v[i];
+    }
+    v[n - 1]->next = NULL;
+    run->head = v[0];
+    run->tail = v[n - 1];
+    run->len = n;
+    return list;
+}
+
+/* Find the longest prefix of the run at @node which sorts before @key, ties
+ * included if @ties is set. Probes 1, 2, 4, ... nodes further each time, then
+ * bisects the last gap, so that it takes O(log k) comparisons for a prefix of
+ * k nodes, though still k steps. Returns the last node of the prefix, or NULL
+ * if it is empty, and adds its length to @count.
+ */
+static struct list_head *run_gallop(struct list_head *node,
+                                    const struct list_head *key,
+                                    bool ties,
+                                    size_t *count)
+{
+    const int bound = ties ? 1 : 0;
+    struct list_head *last = node;
+    size_t step = 1, gap;
+
+    if (node_cmp(node, key) >= bound)
+        return NULL;
+
+    (*count)++;
+    for (;;) {
+        struct list_head *probe = list_walk(last, step);
+        if (!probe || node_cmp(probe, key) >= bound) {
+            gap = step;
+            break;
+        }
+        last = probe;
+        *count += step;
+        step <<= 1;
+    }
+
+    /* The node @gap steps after @last, if any, is not in the prefix */
+    while (gap > 1) {
+        size_t half = gap / 2;
+        struct list_head *mid = list_walk(last, half);
+        if (mid && node_cmp(mid, key) < bound) {
+            last = mid;
+            *count += half;
+            gap -= half;
+        } else {
+            gap = half;
+        }
+    }
+
+    return last;
+}
+
+/* Merge run @b into run @a, which precedes it. Runs which do not overlap
+ * are concatenated after two comparisons. Otherwise, once either run wins
+ * @min_gallop times in a row, whole stretches of it are found by galloping
+ * and linked at once. The prev pointers only need fixing where the runs are
+ * joined.
+ */
+static void run_merge(struct sort_run *a,
+                      const struct sort_run *b,
+                      size_t *min_gallop)
+{
+    struct list_head *x = a->head, *y = b->head;
+    struct list_head dummy, *tail = &dummy;
+    size_t wins_x = 0, wins_y = 0, gallop = *min_gallop;
+
+    if (node_cmp(a->tail, y) <= 0) {
+        a->tail->next = y;
+        y->prev = a->tail;
+        a->tail = b->tail;
+        a->len += b->len;
+        return;
+    }
+
+    if (node_cmp(b->tail, x) < 0) {
+        b->tail->next = x;
+        x->prev = b->tail;
+        a->head = y;
+        a->len += b->len;
+        return;
+    }
+
+    while (x && y) {
+        if (wins_x >= gallop || wins_y >= gallop) {
+            size_t n = 0;
+            struct list_head *last;
+            bool from_x = wins_x;
+            if (from_x) {
+                last = run_gallop(x, y, true, &n);
+            } else {
+                last = run_gallop(y, x, false, &n);
+            }
+
+            /* Stay eager to gallop while it pays off */
+            if (n >= SORT_MIN_GALLOP) {
+                if (gallop > 1)
+                    gallop--;
+            } else {
+                gallop++;
+            }
+            wins_x = wins_y = 0;
+
+            /* An empty prefix means that the other run wins the next node */
+            if (!last)
+                from_x = !from_x;
+            if (from_x) {
+                tail->next = x;
+                x->prev = tail;
+                tail = last ? last : x;
+                x = tail->next;
+                wins_x = 1;
+            } else {
+                tail->next = y;
+                y->prev = tail;
+                tail = last ? last : y;
+                y = tail->next;
+                wins_y = 1;
+            }
+            continue;
+        }
+
+        if (node_cmp(x, y) <= 0) {
+            tail->next = x;
+            x->prev = tail;
+            tail = x;
+            x = x->next;
+            wins_x++;
+            wins_y = 0;
+        } else {
+            tail->next = y;
+            y->prev = tail;
+            tail = y;
+            y = y->next;
+            wins_y++;
+            wins_x = 0;
+        }
+    }
+
+    if (x) {
+        tail->next = x;
+        x->prev = tail;
+    } else {
+        tail->next = y;
+        y->prev = tail;
+        a->tail = b->tail;
+    }
+    *min_gallop = gallop;
+    a->head = dummy.next;
+    a->len += b->len;
+}
+
+/* Merge the runs at @i and @i + 1 of the stack */
+static void runs_merge_at(struct sort_run *runs,
+                          size_t *n,
+                          size_t i,
+                          size_t *min_gallop)
+{
+    run_merge(&runs[i], &runs[i + 1], min_gallop);
+    if (i + 3 == *n)
+        runs[i + 1] = runs[i + 2];
+    (*n)--;
+}
+
+/* Order of runs in the heap of runs_merge_kway() */
+static inline bool runs_less(const struct sort_run *runs, size_t a, size_t b)
+{
+    int cmp = node_cmp(runs[a].head, runs[b].head);
+    return cmp < 0 || (!cmp && a < b);
+}
+
+static void runs_sift_down(const struct sort_run *runs,
+                           size_t *heap,
+                           size_t n,
+                           size_t i)
+{
+    size_t top = heap[i];
+    for (;;) {
+        size_t child = 2 * i + 1;
+        if (child >= n)
+            break;
+        if (child + 1 < n && runs_less(runs, heap[child + 1], heap[child]))
+            child++;
+        if (!runs_less(runs, heap[child], top))
+            break;
+        heap[i] = heap[child];
+        i = child;
+    }
+    heap[i] = top;
+}
+
+/* Merge @k runs into the list at @head in a single pass, taking the least
+ * first element from a binary heap of the runs in @heap, of @k entries. Ties
+ * go to the earlier run, so that the merge is stable. The last run left is
+ * linked as a whole.
+ */
+static void runs_merge_kway(struct list_head *head,
+                            struct sort_run *runs,
+                            size_t k,
+                            size_t *heap)
+{
+    struct list_head *tail = head;
+    size_t n = k;
+
+    for (size_t i = 0; i < k; i++)
+        heap[i] = i;
+    for (size_t i = n / 2; i-- > 0;)
+        runs_sift_down(runs, heap, n, i);
+
+    while (n > 1) {
+        struct sort_run *run = &runs[heap[0]];
+        struct list_head *node = run->head;
+        tail->next = node;
+        node->prev = tail;
+        tail = node;
+
+        run->head = node->next;
+        if (!run->head)
+            heap[0] = heap[--n];
+        runs_sift_down(runs, heap, n, 0);
+    }
+
+    tail->next = runs[heap[0]].head;
+    tail->next->prev = tail;
+    head->prev = runs[heap[0]].tail;
+    head->prev->next = head;
+}
+
+/* Natural merge sort after Timsort: ascending and descending runs already
+ * in the queue are taken as they are, and merged on a stack whose run
+ * lengths are kept growing faster than the Fibonacci numbers, from the top
+ * down. Sorted input takes n - 1 comparisons, and input made of k runs
+ * takes O(n log k).
+ */
+static void sort_natural(struct list_head *head, size_t size)
+{
+    struct sort_run runs[SORT_MAX_RUNS];
+    size_t n = 0, min_gallop = SORT_MIN_GALLOP;
+    size_t min_run = sort_min_run(size);
+    struct list_head *list = head->next;
+
+    head->prev->next = NULL;
+    while (list) {
+        list = run_take(&runs[n], list);
+        if (runs[n].len < min_run && list)
+            list = run_extend(&runs[n], list, min_run);
+        n++;
+
+        while (n > 1) {
+            size_t i = n - 2;
+            if ((i > 0 && runs[i - 1].len <= runs[i].len + runs[i + 1].len) ||
+                (i > 1 && runs[i - 2].len <= runs[i - 1].len + runs[i].len)) {
+                if (runs[i - 1].len < runs[i + 1].len)
+                    i--;
+            } else if (runs[i].len > runs[i + 1].len) {
+                break;
+            }
+            runs_merge_at(runs, &n, i, &min_gallop);
+        }
+    }
+
+    while (n > 1) {
+        size_t i = n - 2;
+        if (i > 0 && runs[i - 1].len < runs[i + 1].len)
+            i--;
+        runs_merge_at(runs, &n, i, &min_gallop);
+    }
+
+    head->next = runs[0].head;
+    runs[0].head->prev = head;
+    head->prev = runs[0].tail;
+    runs[0].tail->next = head;
+}
+
+/* Number of nodes of @a among the first @d of its merge with @b, arrays of
+ * the nodes of two runs. Taking fewer is too few as long as the next node of
+ * @a is not greater than the last one taken from @b.
+ */
+static size_t merge_path(struct list_head **a,
+                         size_t len_a,
+                         struct list_head **b,
+                         size_t len_b,
+                         size_t d)
+{
+    size_t lo = d > len_b ? d - len_b : 0;
+    size_t hi = d < len_a ? d : len_a;
+
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (node_cmp(a[mid], b[d - mid - 1]) <= 0)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    return lo;
+}
+
+/* Merge the nodes @from to @to excluded of the merge of @a and @b into
+ * @piece, cutting them out of the runs
+ */
+static void merge_piece(struct sort_run *piece,
+                        struct list_head **a,
+                        size_t len_a,
+                        struct list_head **b,
+                        size_t len_b,
+                        size_t from,
+                        size_t to)
+{
+    size_t a_from = merge_path(a, len_a, b, len_b, from);
+    size_t a_to = merge_path(a, len_a, b, len_b, to);
+    size_t min_gallop = SORT_MIN_GALLOP;
+    struct sort_run rest;
+
+    merge_cut(piece, a, a_from, a_to);
+    merge_cut(&rest, b, from - a_from, to - a_to);
+    if (!piece->len)
+        *piece = rest;
+    else if (rest.len)
+        run_merge(piece, &rest, &min_gallop);
+}
+
+/* The removals of q_descend() from a queue of at least two elements */
+static void descend(struct list_head *head)
+{
+    queue_t *q = queue_of(head);
+    struct list_head *node = head->prev;
+    struct list_head *pnode = node->prev;
+    element_t *max = NULL;
+    char *pending = NULL, **defer = async_free_mode ? &pending : NULL;
+
+    for (; node != head; node = pnode) {
+        element_t *entry = list_entry(node, element_t, list);
+        pnode = node->prev;
+        if (!max || SORT_CMP(entry, max) > 0) {
+            max = entry;
+        } else {
+            list_del(node);
+            element_release(entry, defer);
+            q->size--;
+        }
+    }
+
+    values_defer(pending);
+}
+
+/* Order of the heap of topk(), the worst entry on top. Ties go to the later
+ * node, so that the earlier one is kept and the selection is stable.
+ */
+static inline bool topk_worse(const struct topk_item *a,
+                              const struct topk_item *b)
+{
+    int cmp = node_cmp(a->node, b->node);
+    return cmp > 0 || (!cmp && a->seq > b->seq);
+}
+
+static void topk_sift_down(struct topk_item *heap, size_t n, size_t i)
+{
+    struct topk_item top = heap[i];
+    for (;;) {
+        size_t child = 2 * i + 1;
+        if (child >= n)
+            break;
+        if (child + 1 < n && topk_worse(&heap[child + 1], &heap[child]))
+            child++;
+        if (!topk_worse(&heap[child], &top))
+            break;
+        heap[i] = heap[child];
+        i = child;
+    }
+    heap[i] = top;
+}
+
+/* Move the @k least nodes of the queue at @head, of more than @k, to its
+ * front in order. A heap of the best @k so far in @heap, of @k entries, is
+ * checked against each node in turn, most of which only compare with its top.
+ * The heap is sorted in place at the end.
+ */
+static void topk(struct list_head *head, size_t k, struct topk_item *heap)
+{
+    struct list_head *node = head->next;
+    size_t seq = 0;
+
+    for (; seq < k; node = node->next, seq++)
+        heap[seq] = (struct topk_item){node, seq};
+    for (size_t i = k / 2; i-- > 0;)
+        topk_sift_down(heap, k, i);
+
+    for (; node != head; node = node->next, seq++) {
+        if (node_cmp(node, heap[0].node) < 0) {
+            heap[0] = (struct topk_item){node, seq};
+            topk_sift_down(heap, k, 0);
+        }
+    }
+
+    for (size_t n = k; n-- > 1;) {
+        struct topk_item worst = heap[0];
+        heap[0] = heap[n];
+        heap[n] = worst;
+        topk_sift_down(heap, n, 0);
+    }
+    for (size_t i = k; i-- > 0;)
+        list_move(heap[i].node, head);
+}
+
+#undef node_cmp
+#undef list_cmp
+#undef sort_bottom_up
+#undef run_take
+#undef run_extend
+#undef run_gallop
+#undef run_merge
+#undef runs_merge_at
+#undef runs_less
+#undef runs_sift_down
+#undef runs_merge_kway
+#undef sort_natural
+#undef merge_path
+#undef merge_piece
+#undef descend
+#undef topk_worse
+#undef topk_sift_down
+#undef topk
+#undef SORT_NAME
+#undef SORT_PASTE
+#undef SORT_PASTE_
+#undef SORT_CMP
+#undef SORT_SUFFIX
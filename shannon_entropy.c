@@ -8,10 +8,9 @@
 /* Shannon full integer entropy calculation */
 #define BUCKET_SIZE (1 << 8)
 
-double shannon_entropy(const uint8_t *s)
+double shannon_entropy_n(const uint8_t *s, size_t count)
 {
     assert(s);
-    const uint64_t count = strlen((char *) s);
     uint64_t entropy_sum = 0;
     const uint64_t entropy_max = 8 * LOG2_RET_SHIFT;
 
@@ -32,3 +31,9 @@ double shannon_entropy(const uint8_t *s)
     entropy_sum /= LOG2_ARG_SHIFT;
     return entropy_sum * 100.0 / entropy_max;
 }
+
+double shannon_entropy(const uint8_t *s)
+{
+    assert(s);
+    return shannon_entropy_n(s, strlen((char *) s));
+}
@@ -0,0 +1,138 @@
+#ifndef LAB0_SIMD_CMP_H
+#define LAB0_SIMD_CMP_H
+
+/*
+ * Comparison of byte strings of known length, 16 bytes at a time with SSE2 on
+ * x86 and NEON on aarch64, and 8 or 4 at a time below 16 bytes. Loads never
+ * leave the bytes compared, even near the end of a page: the last 16 bytes
+ * are loaded again, overlapping the ones before, rather than past the end.
+ * The first differing byte is found by scanning a mask of the differences.
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+
+/* Bits of the masks of simd_diff16() per byte */
+#define SIMD_MASK_BITS 1
+
+/* Mask of the bytes in which the 16 bytes at @a and @b differ */
+static inline uint64_t simd_diff16(const unsigned char *a,
+                                   const unsigned char *b)
+{
+    __m128i x = _mm_loadu_si128((const __m128i *) a);
+    __m128i y = _mm_loadu_si128((const __m128i *) b);
+    return (uint16_t) ~_mm_movemask_epi8(_mm_cmpeq_epi8(x, y));
+}
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+
+#define SIMD_MASK_BITS 4
+
+/* NEON has no movemask, but narrowing each 16-bit lane by 4 bits leaves a
+ * nibble per byte
+ */
+static inline uint64_t simd_diff16(const unsigned char *a,
+                                   const unsigned char *b)
+{
+    uint8x16_t eq = vceqq_u8(vld1q_u8(a), vld1q_u8(b));
+    uint8x8_t mask = vshrn_n_u16(vreinterpretq_u16_u8(eq), 4);
+    return ~vget_lane_u64(vreinterpret_u64_u8(mask), 0);
+}
+#endif
+
+/* From 16 bytes on, 16 bytes per step, the last 16 overlapping the ones
+ * before unless @n is a multiple of 16
+ */
+static inline int simd_memcmp_long(const unsigned char *a,
+                                   const unsigned char *b,
+                                   size_t n)
+{
+#ifdef SIMD_MASK_BITS
+    size_t i = 0;
+    uint64_t mask;
+
+    while (!(mask = simd_diff16(a + i, b + i))) {
+        if (i + 16 == n)
+            return 0;
+        i = i + 32 <= n ? i + 16 : n - 16;
+    }
+
+    i += __builtin_ctzll(mask) / SIMD_MASK_BITS;
+    return a[i] - b[i];
+#else
+    return memcmp(a, b, n);
+#endif
+}
+
+static inline uint64_t simd_load_be64(const unsigned char *p)
+{
+    uint64_t v;
+    memcpy(&v, p, sizeof(v));
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    v = __builtin_bswap64(v);
+#endif
+    return v;
+}
+
+static inline uint32_t simd_load_be32(const unsigned char *p)
+{
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    v = __builtin_bswap32(v);
+#endif
+    return v;
+}
+
+/**
+ * simd_memcmp() - Compare the first @n bytes of @p and @q
+ * @p: first string of bytes
+ * @q: second string of bytes
+ * @n: number of bytes to compare
+ *
+ * Below 16 bytes, the first and the last 8 or 4 bytes are compared as
+ * big-endian words, which overlap unless @n is a multiple of them. Either
+ * pair is picked without a branch.
+ *
+ * Return: less than, equal to or greater than zero, like memcmp()
+ */
+static inline int simd_memcmp(const void *p, const void *q, size_t n)
+{
+    const unsigned char *a = p, *b = q;
+
+    if (n >= 16)
+        return simd_memcmp_long(a, b, n);
+
+    if (n >= 8) {
+        uint64_t x = simd_load_be64(a), y = simd_load_be64(b);
+        uint64_t x_last = simd_load_be64(a + n - 8);
+        uint64_t y_last = simd_load_be64(b + n - 8);
+        bool eq = x == y;
+        x = eq ? x_last : x;
+        y = eq ? y_last : y;
+        return (x > y) - (x < y);
+    }
+
+    if (n >= 4) {
+        uint32_t x = simd_load_be32(a), y = simd_load_be32(b);
+        uint32_t x_last = simd_load_be32(a + n - 4);
+        uint32_t y_last = simd_load_be32(b + n - 4);
+        bool eq = x == y;
+        x = eq ? x_last : x;
+        y = eq ? y_last : y;
+        return (x > y) - (x < y);
+    }
+
+    for (size_t i = 0; i < n; i++) {
+        if (a[i] != b[i])
+            return a[i] - b[i];
+    }
+    return 0;
+}
+
+#endif /* LAB0_SIMD_CMP_H */
@@ -0,0 +1,42 @@
+# Free large queues in the background while others keep being filled, then
+# check that no block is left once the last queue is gone
+# Not part of the graded traces: run with ./qtest -v 1 -f on its own
+option fail 0
+option malloc 0
+option async 1
+new
+ih RAND 200000
+it a-value-longer-than-the-element 100000
+new
+it RAND 200000
+ih short 100000
+prev
+free
+ih RAND 100000
+option intern 1
+it a-value-longer-than-the-element 100000
+new
+ih a-value-longer-than-the-element 50000
+it a-second-value-stored-outside 50000
+sort
+dedup
+size
+free
+sort
+descend
+free
+new
+ih gerbil 1000
+ih a-value-longer-than-the-element 1000
+it bear 1000
+it RAND 100000
+free
+option intern 0
+new
+ih RAND 100000
+sort
+new
+ih RAND 100000
+sort
+merge
+free
@@ -0,0 +1,64 @@
+# Compact a queue whose slabs hold released elements, then check its contents
+# and keep inserting, sorting and merging into it
+# Not part of the graded traces: run with ./qtest -v 1 -f on its own
+option fail 0
+option malloc 0
+new
+ih RAND 100
+rh
+rh
+rt
+it dolphin
+it a-value-longer-than-the-element
+ih bear
+ih gerbil
+ih a-second-value-stored-outside
+rh a-second-value-stored-outside
+reverse
+rh a-value-longer-than-the-element
+compact
+rh dolphin
+rt gerbil
+rt bear
+free
+new
+ih gerbil
+ih a-second-value-stored-outside
+it dolphin
+ih bear
+it a-value-longer-than-the-element
+rh
+it cat
+ih aardvark
+sort
+reverse
+compact
+rh gerbil
+rt a-second-value-stored-outside
+it cat
+ih zebra
+it a-value-longer-than-the-element
+sort
+compact
+it elephant
+it fox
+sort
+new
+ih dolphin
+ih bear
+sort
+merge
+size
+rh a-value-longer-than-the-element
+rh a-value-longer-than-the-element
+rh aardvark
+rh bear
+rh cat
+rh cat
+rh dolphin
+rh dolphin
+rh elephant
+rh fox
+rh zebra
+size
+free
@@ -0,0 +1,55 @@
+# Delete duplicates from unsorted queues, whether they are adjacent or far
+# apart, short enough to be stored in the element or not
+# Not part of the graded traces: run with ./qtest -v 1 -f on its own
+option fail 0
+option malloc 0
+option unsorted 1
+new
+dedup
+it gerbil
+dedup
+it bear
+it bear
+dedup
+it dolphin
+it a-value-longer-than-the-element
+it a-value-longer-than-the-element
+it gerbil
+it meerkat
+it a-second-value-stored-outside
+it bear
+it vulture
+it a-value-longer-than-the-element
+it dolphin
+it bear
+it a-third-value-kept-out-of-line
+it meerkat
+dedup
+rh a-second-value-stored-outside
+rh vulture
+rh a-third-value-kept-out-of-line
+size
+free
+new
+option escape 1
+it a\x00b
+it a\x00c
+it a
+it long\x00value\x00over\x00twelve\x00bytes
+it long\x00value\x00over\x00twelve\x00bytez
+it a\x00b
+it long\x00value\x00over\x00twelve\x00bytes
+it a\x00
+dedup
+rh a\x00c
+rh a
+rh long\x00value\x00over\x00twelve\x00bytez
+rh a\x00
+option escape 0
+ih RAND 5000
+it RAND 5000
+dedup
+ih RAND 500
+it RAND 500
+dedup
+free
@@ -0,0 +1,30 @@
+# Values holding null bytes, short enough to be stored in the element or not,
+# through sort, dedup and removal, truncated or not, each checked by qtest
+# Not part of the graded traces: run with ./qtest -v 1 -f on its own
+option fail 0
+option malloc 0
+option escape 1
+new
+it a\x00b
+it a\x00a
+it a
+it a\x00b
+it long\x00value\x00over\x00twelve\x00bytes
+ih long\x00value\x00over\x00twelve\x00bytes
+it long\x00value\x00over\x00twelve\x00bytez
+it back\\slash\x20and\x20space
+ih \x00
+ih \x00\x00
+sort
+rh \x00
+rh \x00\x00
+dedup
+option length 6
+rh a
+rh a\x00a
+rh back\\s
+option length 1024
+rt long\x00value\x00over\x00twelve\x00bytez
+it \x00\x00\x00
+rh \x00\x00\x00
+free
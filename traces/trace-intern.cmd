@@ -0,0 +1,51 @@
+# Insert, deduplicate, sort and merge long values sharing interned copies
+# across queues, then free them, with interning turned off midway
+# Not part of the graded traces: run with ./qtest -v 1 -f on its own
+option fail 0
+option malloc 0
+option intern 1
+new
+ih a-value-longer-than-the-element 3
+it a-second-value-stored-outside
+it a-value-longer-than-the-element
+ih short
+it a-second-value-stored-outside 2
+it a-third-value-kept-out-of-line
+sort
+dedup
+rh a-third-value-kept-out-of-line
+rh short
+size
+free
+new
+it zebra-with-a-rather-long-name
+it a-value-longer-than-the-element 2
+it aardvark-with-a-rather-long-name
+it yak-with-a-rather-long-name
+ih zebra-with-a-rather-long-name
+new
+it aardvark-with-a-rather-long-name
+ih a-value-longer-than-the-element
+it cat
+option intern 0
+it zebra-with-a-rather-long-name
+it a-value-longer-than-the-element
+sort
+reverse
+rh zebra-with-a-rather-long-name
+option intern 1
+ih zebra-with-a-rather-long-name
+sort
+prev
+sort
+merge
+dedup
+rh cat
+rh yak-with-a-rather-long-name
+size
+new
+it zebra-with-a-rather-long-name 1000
+ih RAND 1000
+sort
+free
+free
@@ -0,0 +1,46 @@
+# Compare the sort algorithms on random, sorted and reversed queues
+# Not part of the graded traces: run with ./qtest -v 1 -f on its own
+option fail 0
+option malloc 0
+option timeout 0
+new
+ih RAND 1000000
+time sort
+time sort
+reverse
+time sort
+free
+new
+ih dolphin 1000000
+it gerbil 1000000
+reverse
+time sort
+free
+option sortalgo 1
+new
+ih RAND 1000000
+time sort
+time sort
+reverse
+time sort
+free
+new
+ih dolphin 1000000
+it gerbil 1000000
+reverse
+time sort
+free
+option sortalgo 2
+new
+ih RAND 1000000
+time sort
+time sort
+reverse
+time sort
+free
+new
+ih dolphin 1000000
+it gerbil 1000000
+reverse
+time sort
+free
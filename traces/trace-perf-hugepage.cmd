@@ -0,0 +1,38 @@
+# Compare a large queue with and without huge page slabs
+# Not part of the graded traces: run with ./qtest -v 1 -f on its own
+option fail 0
+option malloc 0
+option timeout 0
+new
+ih RAND 1000000
+ih RAND 1000000
+ih RAND 1000000
+ih RAND 1000000
+ih RAND 1000000
+ih RAND 1000000
+ih RAND 1000000
+ih RAND 1000000
+ih RAND 1000000
+ih RAND 1000000
+time sort
+time size
+time reverse
+time sort
+free
+option hugepage 1
+new
+ih RAND 1000000
+ih RAND 1000000
+ih RAND 1000000
+ih RAND 1000000
+ih RAND 1000000
+ih RAND 1000000
+ih RAND 1000000
+ih RAND 1000000
+ih RAND 1000000
+ih RAND 1000000
+time sort
+time size
+time reverse
+time sort
+free
@@ -0,0 +1,962 @@
+# Merge hundreds of sorted queues, as runs of a k-way heap merge, then a few
+# large ones on 1 and 4 threads
+# Not part of the graded traces: run with ./qtest -v 1 -f on its own
+option fail 0
+option malloc 0
+option timeout 0
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+new
+it RAND 2000
+sort
+time merge
+free
+option threads 1
+new
+it RAND 200000
+sort
+new
+it RAND 200000
+sort
+new
+it RAND 200000
+sort
+new
+it RAND 200000
+sort
+new
+it RAND 200000
+sort
+new
+it RAND 200000
+sort
+new
+it RAND 200000
+sort
+new
+it RAND 200000
+sort
+time merge
+free
+option threads 4
+new
+it RAND 200000
+sort
+new
+it RAND 200000
+sort
+new
+it RAND 200000
+sort
+new
+it RAND 200000
+sort
+new
+it RAND 200000
+sort
+new
+it RAND 200000
+sort
+new
+it RAND 200000
+sort
+new
+it RAND 200000
+sort
+time merge
+free
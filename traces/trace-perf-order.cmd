@@ -0,0 +1,46 @@
+# Sort, merge and descend in every order, each checked by qtest
+# Not part of the graded traces: run with ./qtest -v 1 -f on its own
+option fail 0
+option malloc 0
+option timeout 0
+option order 0
+new
+ih RAND 500000
+time sort
+new
+ih RAND 500000
+sort
+time merge
+time descend
+free
+option order 1
+new
+ih RAND 500000
+time sort
+new
+ih RAND 500000
+sort
+time merge
+time descend
+free
+option order 2
+new
+ih RAND 500000
+time sort
+new
+ih RAND 500000
+sort
+time merge
+time descend
+free
+option order 3
+new
+ih RAND 500000
+time sort
+new
+ih RAND 500000
+sort
+time merge
+time descend
+free
+option order 0
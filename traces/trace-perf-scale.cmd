@@ -0,0 +1,17 @@
+# Fill a queue with more elements than fit into 32-bit counts
+# Not part of the graded traces: needs about 90 GB of memory, run with
+# ./qtest -v 2 -f on its own
+option fail 0
+option malloc 0
+option timeout 0
+option hugepage 1
+new
+time it a 2200000000
+time size
+time ih b 2
+time dm
+time rt a
+time rh b
+time reverse
+time size
+time free
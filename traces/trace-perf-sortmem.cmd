@@ -0,0 +1,26 @@
+# Compare the radix sort with unbounded and with 16 MB of scratch memory
+# Not part of the graded traces: run with ./qtest -v 1 -f on its own
+option fail 0
+option malloc 0
+option timeout 0
+option sortalgo 2
+option sortmem 0
+new
+ih RAND 1000000
+ih RAND 1000000
+ih RAND 1000000
+ih RAND 1000000
+time sort
+reverse
+time sort
+free
+option sortmem 16
+new
+ih RAND 1000000
+ih RAND 1000000
+ih RAND 1000000
+ih RAND 1000000
+time sort
+reverse
+time sort
+free
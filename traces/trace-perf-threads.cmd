@@ -0,0 +1,67 @@
+# Compare sorting on 1, 4 and 16 threads, by merging and by radix sort
+# Not part of the graded traces: run with ./qtest -v 1 -f on its own
+option fail 0
+option malloc 0
+option timeout 0
+option sortalgo 0
+option threads 1
+new
+ih RAND 1000000
+ih RAND 1000000
+ih RAND 1000000
+ih RAND 1000000
+time sort
+reverse
+time sort
+free
+option threads 4
+new
+ih RAND 1000000
+ih RAND 1000000
+ih RAND 1000000
+ih RAND 1000000
+time sort
+reverse
+time sort
+free
+option threads 16
+new
+ih RAND 1000000
+ih RAND 1000000
+ih RAND 1000000
+ih RAND 1000000
+time sort
+reverse
+time sort
+free
+option sortalgo 2
+option threads 1
+new
+ih RAND 1000000
+ih RAND 1000000
+ih RAND 1000000
+ih RAND 1000000
+time sort
+reverse
+time sort
+free
+option threads 4
+new
+ih RAND 1000000
+ih RAND 1000000
+ih RAND 1000000
+ih RAND 1000000
+time sort
+reverse
+time sort
+free
+option threads 16
+new
+ih RAND 1000000
+ih RAND 1000000
+ih RAND 1000000
+ih RAND 1000000
+time sort
+reverse
+time sort
+free
@@ -0,0 +1,21 @@
+# Top K against a full sort of the same queue, each checked by qtest
+# Not part of the graded traces: run with ./qtest -v 1 -f on its own
+option fail 0
+option malloc 0
+option timeout 0
+new
+ih RAND 1000000
+time topk 10
+new
+ih RAND 1000000
+time topk 1000
+new
+ih RAND 1000000
+time sort
+free
+option order 1
+new
+ih RAND 1000000
+time topk 10
+free
+option order 0